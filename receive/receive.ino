@@ -9,6 +9,26 @@ char recMsg[81];
 bool currentlyReceiving = false;
 int currentLine = 0;
 
+// -----GAP CALIBRATION------
+// codes must match transmit.ino
+const uint8_t CAL_GAP = 0x12;     // step header, address field carries the gap in ms
+const uint8_t CAL_PROBE = 0x13;   // burst frame
+const uint8_t CAL_END = 0x14;     // calibration finished
+const int CAL_BURST = 20;         // probes sent per gap step
+const int CAL_WIDEST_GAP = 25;    // first gap of every run
+
+int calGap = -1;      // gap of the step in progress, -1 when no run is in progress
+int calLastGap = -1;  // previous step's gap, headers must arrive in decreasing order
+int calCount = 0;
+unsigned long calLatencySum = 0;  // poll -> resume() time in us
+unsigned long calLatencyMax = 0;
+unsigned long calEndLatencySum = 0;  // frame end -> resume() time in us
+unsigned long calEndLatencyMax = 0;
+unsigned long calFrameEnd = 0;    // micros() estimate of the last mark of the previous frame
+unsigned long calWorkMax = 0;     // serial/LCD time per probe in us
+int calSafeGap = -1;  // smallest gap with no loss (all wider gaps also clean)
+bool calFailed = false;
+
 void setup() {
   Serial.begin(9600);
   pinMode(3, OUTPUT);
@@ -23,74 +43,230 @@ void setup() {
   lcd.print("WAITING TO RECEIVE");
 }
 
+// CLEARS RESULTS FROM ANY EARLIER OR ABANDONED RUN
+void resetCal() {
+  calGap = -1;
+  calLastGap = -1;
+  calSafeGap = -1;
+  calFailed = false;
+}
+
+// CLOSES OUT THE CURRENT GAP STEP AND REPORTS ITS LOSS
+void finishCalStep() {
+  if (calGap < 0) return;
+
+  Serial.print(F("GAP "));
+  Serial.print(calGap);
+  lcd.setCursor(0, 1);
+  lcd.print("GAP ");
+  lcd.print(calGap);
+
+  if (calCount > CAL_BURST) {
+    // next step's header was lost and its probes landed here
+    Serial.print(F(" ms: INVALID, "));
+    Serial.print(calCount);
+    Serial.println(F(" probes (header lost?)"));
+    lcd.print("ms INVALID   ");
+    calFailed = true;
+    calGap = -1;
+    return;
+  }
+
+  int lost = CAL_BURST - calCount;
+
+  Serial.print(F(" ms: lost "));
+  Serial.print(lost);
+  Serial.print('/');
+  Serial.print(CAL_BURST);
+  Serial.print(F(", frame end->resume avg "));
+  Serial.print(calCount > 0 ? calEndLatencySum / calCount : 0);
+  Serial.print(F(" us max "));
+  Serial.print(calEndLatencyMax);
+  Serial.print(F(" us, poll->resume avg "));
+  Serial.print(calCount > 0 ? calLatencySum / calCount : 0);
+  Serial.print(F(" us max "));
+  Serial.print(calLatencyMax);
+  Serial.print(F(" us, serial/LCD max "));
+  Serial.print(calWorkMax);
+  Serial.println(F(" us"));
+
+  lcd.print("ms LOST ");
+  lcd.print(lost);
+  lcd.print("   ");
+
+  // gaps are sent widest first, so the first lossy step ends the safe range
+  if (lost == 0 && !calFailed) calSafeGap = calGap;
+  else calFailed = true;
+
+  calGap = -1;
+}
+
+// Print protocol + address/command (don’t rely on decodedRawData)
+void logFrame(const IRData &frame) {
+  Serial.print(F(" Addr=0x"));  // SHOULD ALWAYS BE 0x0000
+  Serial.print(frame.address, HEX);
+
+  Serial.print(F(" Cmd=0x"));  // MESSAGE CONTENT
+  Serial.println(frame.command, HEX);
+
+  Serial.print(F("Protocol="));  // IF PROTOCOL IS NOT NEC IT WAS HANDLED IMPROPERLY
+  Serial.print(getProtocolString(frame.protocol));
+  Serial.println();
+}
+
 void loop() {
-  if (IrReceiver.decode()) {
-    // Print protocol + address/command (don’t rely on decodedRawData)
-    Serial.print(F(" Addr=0x"));  // SHOULD ALWAYS BE 0x0000
-    Serial.print(IrReceiver.decodedIRData.address, HEX);
+  if (!IrReceiver.available()) return;
 
-    Serial.print(F(" Cmd=0x"));  // MESSAGE CONTENT
-    Serial.println(IrReceiver.decodedIRData.command, HEX);
+  // poll->resume only covers decode() and the copy; a frame that finished
+  // while the loop was busy with the previous one has been waiting longer
+  unsigned long pollAt = micros();
+  if (!IrReceiver.decode()) {
+    IrReceiver.resume();
+    return;
+  }
 
-    Serial.print(F("Protocol="));  // IF PROTOCOL IS NOT NEC IT WAS HANDLED IMPROPERLY
-    Serial.print(getProtocolString(IrReceiver.decodedIRData.protocol));
-    Serial.println();
+  // on-air timing of this frame, read before resume() reuses the buffer:
+  // the gap since the previous frame's last mark, and the frame's length
+  unsigned long gapMicros = (unsigned long)IrReceiver.decodedIRData.initialGapTicks * MICROS_PER_TICK;
+  unsigned long frameMicros = 0;
+  for (uint_fast8_t i = 1; i < IrReceiver.decodedIRData.rawlen; i++) {
+    frameMicros += IrReceiver.decodedIRData.rawDataPtr->rawbuf[i];
+  }
+  frameMicros *= MICROS_PER_TICK;
 
-    if (static_cast<unsigned char>(IrReceiver.decodedIRData.command) == static_cast<unsigned char>(0x0006)) {
-      lcd.clear();
-      lcd.print("ALIGNMENT RECEIVED");
-      Serial.println("ALIGNMENT SIGNAL RECEIVED");
-      IrReceiver.resume();
-      return;
-    }
-    else if (static_cast<unsigned char>(IrReceiver.decodedIRData.command) == static_cast<unsigned char>(0x0011)) {
-      lcd.clear();
-      lcd.print("WAITING TO RECEIVE");
-      Serial.println("ESCAPE RECEIVED");
-      delay(50);
-      IrReceiver.resume();
-      return;
-    }
+  // copy the frame and re-arm the receiver before any serial/LCD work,
+  // otherwise a frame arriving during that work is dropped
+  IRData frame = IrReceiver.decodedIRData;
+  IrReceiver.resume();
+  unsigned long resumedAt = micros();
+  unsigned long resumeLatency = resumedAt - pollAt;
 
-    else {
-    if (!currentlyReceiving) {
-      currentlyReceiving = true;
-      lcd.clear();
-      currentLine = 0;
-    }
+  uint8_t command = static_cast<uint8_t>(frame.command);
 
-    char receivedChar = static_cast<unsigned char>(IrReceiver.decodedIRData.command);
+  // overflowed or foreign frames during a run must not reach the message
+  // path, where a decoded command of 0 would end a message
+  if (calGap >= 0 && (frame.protocol != NEC || (command != CAL_GAP && command != CAL_PROBE && command != CAL_END))) return;
 
-    if (receivedChar == '\0') {
-      currentlyReceiving = false;
-      currentLine = 0;
-      msgLength = 0;
-      Serial.print(F("\n****message received: "));
-      Serial.println(recMsg);
-      IrReceiver.resume();
-      return;
-    }
+  if (command == CAL_PROBE) {
+    if (calGap < 0) return;
+    calCount++;
+    calLatencySum += resumeLatency;
+    if (resumeLatency > calLatencyMax) calLatencyMax = resumeLatency;
 
-    if (isprint(receivedChar)) {
-      Serial.print(F(" CHAR: "));
-      Serial.print(receivedChar);
-      recMsg[msgLength++] = receivedChar;
-      lcd.print(receivedChar);
+    // probes follow each other, so the frame end is chained from the previous
+    // one; a lost probe breaks the chain, but that step has already failed
+    calFrameEnd += gapMicros + frameMicros;
+    unsigned long endLatency = resumedAt - calFrameEnd;
+    calEndLatencySum += endLatency;
+    if (endLatency > calEndLatencyMax) calEndLatencyMax = endLatency;
 
-      if (msgLength % 20 == 0) lcd.setCursor(0, ++currentLine);
+    // same per-frame serial/LCD work as a message character, so loss
+    // reflects the real message path
+    unsigned long workStart = micros();
+    logFrame(frame);
+    Serial.print(F(" CHAR: "));
+    Serial.print('.');
+    lcd.setCursor((calCount - 1) % 20, 3);
+    lcd.print('.');
+    unsigned long work = micros() - workStart;
+    if (work > calWorkMax) calWorkMax = work;
+    return;
+  }
+  else if (command == CAL_GAP) {
+    if (calGap < 0 || frame.address == CAL_WIDEST_GAP) {  // new run
+      resetCal();
+      lcd.clear();
+      lcd.print("CALIBRATING");
+      Serial.println("CALIBRATION STARTED");
     } else {
-      Serial.print('X');
-      recMsg[msgLength++] = 'X';
-      lcd.print(F("X"));
-      if (msgLength % 20 == 0) {
-        lcd.setCursor(0, ++currentLine);
+      finishCalStep();
+      if (static_cast<int>(frame.address) >= calLastGap) {
+        Serial.println(F("GAP HEADER OUT OF ORDER"));
+        calFailed = true;
       }
     }
+    calGap = frame.address;
+    calLastGap = calGap;
+    calCount = 0;
+    calLatencySum = 0;
+    calLatencyMax = 0;
+    calEndLatencySum = 0;
+    calEndLatencyMax = 0;
+    // the loop is idle before a header, so it is seen as soon as the receiver
+    // stops, one record gap after the last mark
+    calFrameEnd = pollAt - RECORD_GAP_MICROS;
+    calWorkMax = 0;
+    lcd.setCursor(0, 3);
+    lcd.print("                    ");
+    return;
+  }
+  else if (command == CAL_END) {
+    if (calGap < 0) return;  // no run in progress
+    finishCalStep();
+    lcd.setCursor(0, 2);
+    if (calSafeGap >= 0) {
+      lcd.print("SAFE GAP: ");
+      lcd.print(calSafeGap);
+      lcd.print(" ms");
+      Serial.print(F("SAFE GAP: "));
+      Serial.print(calSafeGap);
+      Serial.println(F(" ms"));
+    } else {
+      lcd.print("NO SAFE GAP FOUND");
+      Serial.println("NO SAFE GAP FOUND");
+    }
+    return;
+  }
 
-    // For deep debugging, uncomment to see timings:
-    // IrReceiver.printIRResultRawFormatted(&Serial, true);
+  logFrame(frame);
 
-    IrReceiver.resume();
+  if (command == static_cast<unsigned char>(0x0006)) {
+    lcd.clear();
+    lcd.print("ALIGNMENT RECEIVED");
+    Serial.println("ALIGNMENT SIGNAL RECEIVED");
+    return;
+  }
+  else if (command == static_cast<unsigned char>(0x0011)) {
+    lcd.clear();
+    lcd.print("WAITING TO RECEIVE");
+    Serial.println("ESCAPE RECEIVED");
+    delay(50);
+    return;
+  }
+
+  if (!currentlyReceiving) {
+    currentlyReceiving = true;
+    lcd.clear();
+    currentLine = 0;
   }
+
+  char receivedChar = command;
+
+  if (receivedChar == '\0') {
+    currentlyReceiving = false;
+    currentLine = 0;
+    msgLength = 0;
+    Serial.print(F("\n****message received: "));
+    Serial.println(recMsg);
+    return;
   }
+
+  if (isprint(receivedChar)) {
+    Serial.print(F(" CHAR: "));
+    Serial.print(receivedChar);
+    recMsg[msgLength++] = receivedChar;
+    lcd.print(receivedChar);
+
+    if (msgLength % 20 == 0) lcd.setCursor(0, ++currentLine);
+  } else {
+    Serial.print('X');
+    recMsg[msgLength++] = 'X';
+    lcd.print(F("X"));
+    if (msgLength % 20 == 0) {
+      lcd.setCursor(0, ++currentLine);
+    }
+  }
+
+  // For deep debugging, uncomment to see timings (needs to run before resume()):
+  // IrReceiver.printIRResultRawFormatted(&Serial, true);
 }
@@ -1,3 +1,4 @@
+#include <EEPROM.h>
 #include <IRremote.hpp>
 #include <LiquidCrystal_I2C.h>
 #include <PS2Keyboard.h>
@@ -7,7 +8,9 @@
 enum Mode { IDLE = 0,
             EDIT,
             TRANSMIT,
-            ALIGN } mode = IDLE;
+            ALIGN,
+            CALIBRATE,
+            SET_GAP } mode = IDLE;
 
 Servo myservo;
 int pos = 90;
@@ -19,6 +22,24 @@ int msgLength = 0;
 int currentLine = 0;  // for QOL when printing
 PS2Keyboard keyboard;
 
+// -----GAP CALIBRATION------
+// codes must match receive.ino
+const uint8_t CAL_GAP = 0x12;    // step header, address field carries the gap in ms
+const uint8_t CAL_PROBE = 0x13;  // burst frame
+const uint8_t CAL_END = 0x14;    // calibration finished
+const int CAL_BURST = 20;        // probes sent per gap step
+const int CAL_SETTLE_MS = 300;   // quiet time around each burst so the receiver can report
+// widest first. the receiver only ends a frame, and only starts the next one,
+// after a space longer than RECORD_GAP_MICROS (5 ms), so narrower gaps always fail
+const uint8_t calGaps[] = { 25, 20, 15, 10, 8, 6 };
+const int CAL_END_COPIES = 3;  // receiver ignores extra copies
+const int GAP_SIG_ADDR = 0;      // signature byte, tells our gap apart from other sketches' data
+const int GAP_EEPROM_ADDR = 1;
+const uint8_t GAP_SIG = 0xA9;
+
+uint8_t frameGap = 25;  // ms between NEC frames, loaded from EEPROM once calibrated
+int gapEntry = -1;      // gap typed in SET_GAP mode, -1 when nothing typed
+
 void setup() {
   // SERVO
   myservo.attach(9);
@@ -26,6 +47,9 @@ void setup() {
   // IR
   IrSender.begin(3);  // initialize sender on default pin
 
+  uint8_t storedGap = EEPROM.read(GAP_EEPROM_ADDR);
+  if (EEPROM.read(GAP_SIG_ADDR) == GAP_SIG && isCalGap(storedGap)) frameGap = storedGap;
+
   // keyboard
   keyboard.begin(8, 2);
 
@@ -53,8 +77,16 @@ void showMenu() {
   lcd.setCursor(0, 2);
   lcd.print("[S] Send message");
   lcd.setCursor(0, 3);
-  lcd.print("[A] Alignment");
-  Serial.println("Enter mode: M=Edit Message, S=Send Message");
+  lcd.print("[A] Align  [C] Calib");
+  Serial.println("Enter mode: M=Edit Message, S=Send Message, A=Alignment, C=Calibrate gap");
+}
+
+// TRUE IF gap IS ONE OF THE GAPS TESTED BY calibrateGap()
+bool isCalGap(int gap) {
+  for (unsigned int i = 0; i < sizeof(calGaps); i++) {
+    if (calGaps[i] == gap) return true;
+  }
+  return false;
 }
 
 void sendMessage(char* message) {
@@ -62,7 +94,33 @@ void sendMessage(char* message) {
     uint16_t charToSend = static_cast<uint16_t>(msg[i]);
 
     IrSender.sendNEC(0x0000, charToSend, 0);  // address, command, # of repeats
-    delay(25);
+    delay(frameGap);
+  }
+}
+
+// SENDS A BURST OF PROBES AT EACH GAP, WIDEST FIRST. THE RECEIVER REPORTS LOSS PER GAP
+void calibrateGap() {
+  for (unsigned int i = 0; i < sizeof(calGaps); i++) {
+    uint8_t gap = calGaps[i];
+    lcd.setCursor(0, 1);
+    lcd.print("Testing gap ");
+    lcd.print(gap);
+    lcd.print("ms  ");
+    Serial.print("Calibrating gap ");
+    Serial.print(gap);
+    Serial.println(" ms");
+
+    IrSender.sendNEC(gap, CAL_GAP, 0);
+    delay(CAL_SETTLE_MS);
+    for (int n = 0; n < CAL_BURST; n++) {
+      IrSender.sendNEC(0x0000, CAL_PROBE, 0);
+      delay(gap);
+    }
+    delay(CAL_SETTLE_MS);
+  }
+  for (int n = 0; n < CAL_END_COPIES; n++) {
+    IrSender.sendNEC(0x0000, CAL_END, 0);
+    delay(CAL_SETTLE_MS);
   }
 }
 
@@ -102,6 +160,15 @@ void loop() {
           lcd.print("Please use left and ");
           lcd.setCursor(0, 2);
           lcd.print("right arrow keys.");
+          break;
+
+        case 'C':
+          mode = CALIBRATE;
+          lcd.clear();
+          lcd.print("Mode: Calibrate");
+          Serial.println("** Gap Calibration Mode **");
+          break;
+
         default: break;
       }
     }
@@ -188,4 +255,70 @@ void loop() {
       return;
     }
   }
+
+  if (mode == CALIBRATE) {  // ------GAP CALIBRATION--------
+    calibrateGap();
+    mode = SET_GAP;
+    gapEntry = -1;
+    lcd.clear();
+    lcd.print("Enter SAFE GAP shown");
+    lcd.setCursor(0, 1);
+    lcd.print("on receiver (ms):");
+    lcd.setCursor(0, 3);
+    lcd.print("Current: ");
+    lcd.print(frameGap);
+    Serial.println("Type the safe gap reported by the receiver, Enter to save, Esc to cancel.");
+  }
+
+  if (mode == SET_GAP) {
+    if (keyboard.available()) {
+      char ch = keyboard.read();
+      if (ch == PS2_ESC) {
+        mode = IDLE;
+        showMenu();
+        return;
+      }
+      if (ch == '\r' || ch == '\n') {  // Enter key: store gap
+        if (gapEntry >= 0 && !isCalGap(gapEntry)) {  // only accept gaps that were tested
+          lcd.setCursor(0, 2);
+          lcd.print("Not a tested gap    ");
+          Serial.print("Gap must be one of:");
+          for (unsigned int i = 0; i < sizeof(calGaps); i++) {
+            Serial.print(' ');
+            Serial.print(calGaps[i]);
+          }
+          Serial.println();
+          gapEntry = -1;
+          return;
+        }
+        if (gapEntry >= 0) {
+          frameGap = gapEntry;
+          EEPROM.update(GAP_EEPROM_ADDR, frameGap);
+          EEPROM.update(GAP_SIG_ADDR, GAP_SIG);
+          lcd.clear();
+          lcd.print("Gap saved: ");
+          lcd.print(frameGap);
+          lcd.print(" ms");
+          Serial.print("Frame gap set to ");
+          Serial.print(frameGap);
+          Serial.println(" ms");
+          delay(800);
+        }
+        mode = IDLE;
+        showMenu();
+        return;
+      } else if (ch == 8 || ch == 127) {  // Backspace: drop last digit
+        gapEntry = (gapEntry >= 10) ? gapEntry / 10 : -1;
+      } else if (isdigit((unsigned char)ch)) {
+        int next = (gapEntry < 0 ? 0 : gapEntry * 10) + (ch - '0');
+        if (next <= calGaps[0]) gapEntry = next;
+      } else {
+        return;
+      }
+      lcd.setCursor(0, 2);
+      lcd.print("                    ");
+      lcd.setCursor(0, 2);
+      if (gapEntry >= 0) lcd.print(gapEntry);
+    }
+  }
 }
\ No newline at end of file